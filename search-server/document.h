@@ -6,6 +6,7 @@
 #pragma once
 
 #include <iostream>
+#include <limits>
 
 
 
@@ -30,4 +31,25 @@ enum class DocumentStatus
     REMOVED,
 };
 
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Встроенный фильтр поиска: статус документа и диапазон рейтинга [min_rating, max_rating].
+// В отличие от произвольного предиката применяется сервером до подсчета релевантности
+struct DocumentFilter
+{
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+
+    bool HasRatingRange() const
+    {
+        return min_rating != std::numeric_limits<int>::min() || max_rating != std::numeric_limits<int>::max();
+    }
+
+    bool AcceptsRating(int rating) const
+    {
+        return rating >= min_rating && rating <= max_rating;
+    }
+};
+
 std::ostream &operator<<(std::ostream &os, const Document &document);
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    size_t CountBits(uint64_t word)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(word);
+#else
+        size_t count = 0;
+        for (; word != 0; word &= word - 1)
+        {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    uint16_t HighBits(int document_id)
+    {
+        return static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16);
+    }
+
+    uint16_t LowBits(int document_id)
+    {
+        return static_cast<uint16_t>(static_cast<uint32_t>(document_id) & 0xFFFF);
+    }
+}
+
+std::vector<DocumentBitmap::Container>::iterator DocumentBitmap::FindContainer(uint16_t key)
+{
+    return std::lower_bound(containers_.begin(), containers_.end(), key,
+                            [](const Container &container, uint16_t value) { return container.key < value; });
+}
+
+std::vector<DocumentBitmap::Container>::const_iterator DocumentBitmap::FindContainer(uint16_t key) const
+{
+    return std::lower_bound(containers_.begin(), containers_.end(), key,
+                            [](const Container &container, uint16_t value) { return container.key < value; });
+}
+
+bool DocumentBitmap::ContainerContains(const Container &container, uint16_t low)
+{
+    if (container.IsBitset())
+    {
+        return (container.bits[low / 64] >> (low % 64)) & 1;
+    }
+    return std::binary_search(container.array.begin(), container.array.end(), low);
+}
+
+void DocumentBitmap::ToBitset(Container &container)
+{
+    if (container.IsBitset())
+    {
+        return;
+    }
+    container.bits.assign(BITSET_WORDS, 0);
+    for (const uint16_t low : container.array)
+    {
+        container.bits[low / 64] |= uint64_t{1} << (low % 64);
+    }
+    container.array.clear();
+    container.array.shrink_to_fit();
+}
+
+void DocumentBitmap::Normalize(Container &container)
+{
+    if (!container.IsBitset())
+    {
+        container.cardinality = static_cast<uint32_t>(container.array.size());
+        if (container.cardinality > ARRAY_LIMIT)
+        {
+            ToBitset(container);
+        }
+        return;
+    }
+
+    size_t cardinality = 0;
+    for (const uint64_t word : container.bits)
+    {
+        cardinality += CountBits(word);
+    }
+    container.cardinality = static_cast<uint32_t>(cardinality);
+    if (cardinality > ARRAY_LIMIT)
+    {
+        return;
+    }
+
+    container.array.clear();
+    container.array.reserve(cardinality);
+    for (size_t word_index = 0; word_index < BITSET_WORDS; ++word_index)
+    {
+        for (uint64_t word = container.bits[word_index]; word != 0; word &= word - 1)
+        {
+            container.array.push_back(static_cast<uint16_t>(word_index * 64 + LowestBit(word)));
+        }
+    }
+    container.bits.clear();
+    container.bits.shrink_to_fit();
+}
+
+void DocumentBitmap::Add(int document_id)
+{
+    const uint16_t key = HighBits(document_id);
+    const uint16_t low = LowBits(document_id);
+    auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key)
+    {
+        it = containers_.insert(it, Container{});
+        it->key = key;
+    }
+
+    if (it->IsBitset())
+    {
+        uint64_t &word = it->bits[low / 64];
+        const uint64_t mask = uint64_t{1} << (low % 64);
+        if ((word & mask) == 0)
+        {
+            word |= mask;
+            ++it->cardinality;
+        }
+        return;
+    }
+
+    const auto pos = std::lower_bound(it->array.begin(), it->array.end(), low);
+    if (pos != it->array.end() && *pos == low)
+    {
+        return;
+    }
+    it->array.insert(pos, low);
+    if (++it->cardinality > ARRAY_LIMIT)
+    {
+        ToBitset(*it);
+    }
+}
+
+void DocumentBitmap::Remove(int document_id)
+{
+    const uint16_t key = HighBits(document_id);
+    const uint16_t low = LowBits(document_id);
+    const auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key || !ContainerContains(*it, low))
+    {
+        return;
+    }
+
+    if (it->IsBitset())
+    {
+        it->bits[low / 64] &= ~(uint64_t{1} << (low % 64));
+        if (--it->cardinality <= ARRAY_LIMIT)
+        {
+            Normalize(*it);
+        }
+    }
+    else
+    {
+        it->array.erase(std::lower_bound(it->array.begin(), it->array.end(), low));
+        --it->cardinality;
+    }
+
+    if (it->cardinality == 0)
+    {
+        containers_.erase(it);
+    }
+}
+
+bool DocumentBitmap::Contains(int document_id) const
+{
+    const uint16_t key = HighBits(document_id);
+    const auto it = FindContainer(key);
+    return it != containers_.end() && it->key == key && ContainerContains(*it, LowBits(document_id));
+}
+
+size_t DocumentBitmap::Size() const
+{
+    size_t size = 0;
+    for (const Container &container : containers_)
+    {
+        size += container.cardinality;
+    }
+    return size;
+}
+
+size_t DocumentBitmap::MemoryUsage() const
+{
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const Container &container : containers_)
+    {
+        bytes += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+void DocumentBitmap::UniteContainers(Container &lhs, const Container &rhs)
+{
+    if (!lhs.IsBitset() && !rhs.IsBitset())
+    {
+        std::vector<uint16_t> united;
+        united.reserve(lhs.array.size() + rhs.array.size());
+        std::set_union(lhs.array.begin(), lhs.array.end(), rhs.array.begin(), rhs.array.end(),
+                       std::back_inserter(united));
+        lhs.array = std::move(united);
+        Normalize(lhs);
+        return;
+    }
+
+    ToBitset(lhs);
+    if (rhs.IsBitset())
+    {
+        for (size_t word_index = 0; word_index < BITSET_WORDS; ++word_index)
+        {
+            lhs.bits[word_index] |= rhs.bits[word_index];
+        }
+    }
+    else
+    {
+        for (const uint16_t low : rhs.array)
+        {
+            lhs.bits[low / 64] |= uint64_t{1} << (low % 64);
+        }
+    }
+    Normalize(lhs);
+}
+
+void DocumentBitmap::IntersectContainers(Container &lhs, const Container &rhs)
+{
+    if (!lhs.IsBitset())
+    {
+        if (rhs.IsBitset())
+        {
+            lhs.array.erase(std::remove_if(lhs.array.begin(), lhs.array.end(),
+                                           [&rhs](uint16_t low) { return !ContainerContains(rhs, low); }),
+                            lhs.array.end());
+        }
+        else
+        {
+            std::vector<uint16_t> intersection;
+            std::set_intersection(lhs.array.begin(), lhs.array.end(), rhs.array.begin(), rhs.array.end(),
+                                  std::back_inserter(intersection));
+            lhs.array = std::move(intersection);
+        }
+        Normalize(lhs);
+        return;
+    }
+
+    if (!rhs.IsBitset())
+    {
+        std::vector<uint16_t> intersection;
+        std::copy_if(rhs.array.begin(), rhs.array.end(), std::back_inserter(intersection),
+                     [&lhs](uint16_t low) { return ContainerContains(lhs, low); });
+        lhs.bits.clear();
+        lhs.bits.shrink_to_fit();
+        lhs.array = std::move(intersection);
+        Normalize(lhs);
+        return;
+    }
+
+    for (size_t word_index = 0; word_index < BITSET_WORDS; ++word_index)
+    {
+        lhs.bits[word_index] &= rhs.bits[word_index];
+    }
+    Normalize(lhs);
+}
+
+void DocumentBitmap::SubtractContainers(Container &lhs, const Container &rhs)
+{
+    if (!lhs.IsBitset())
+    {
+        lhs.array.erase(std::remove_if(lhs.array.begin(), lhs.array.end(),
+                                       [&rhs](uint16_t low) { return ContainerContains(rhs, low); }),
+                        lhs.array.end());
+        Normalize(lhs);
+        return;
+    }
+
+    if (rhs.IsBitset())
+    {
+        for (size_t word_index = 0; word_index < BITSET_WORDS; ++word_index)
+        {
+            lhs.bits[word_index] &= ~rhs.bits[word_index];
+        }
+    }
+    else
+    {
+        for (const uint16_t low : rhs.array)
+        {
+            lhs.bits[low / 64] &= ~(uint64_t{1} << (low % 64));
+        }
+    }
+    Normalize(lhs);
+}
+
+DocumentBitmap &DocumentBitmap::operator|=(const DocumentBitmap &other)
+{
+    std::vector<Container> result;
+    result.reserve(containers_.size() + other.containers_.size());
+    auto lhs = containers_.begin();
+    auto rhs = other.containers_.begin();
+    while (lhs != containers_.end() || rhs != other.containers_.end())
+    {
+        if (rhs == other.containers_.end() || (lhs != containers_.end() && lhs->key < rhs->key))
+        {
+            result.push_back(std::move(*lhs++));
+        }
+        else if (lhs == containers_.end() || rhs->key < lhs->key)
+        {
+            result.push_back(*rhs++);
+        }
+        else
+        {
+            UniteContainers(*lhs, *rhs++);
+            result.push_back(std::move(*lhs++));
+        }
+    }
+    containers_ = std::move(result);
+    return *this;
+}
+
+DocumentBitmap &DocumentBitmap::operator&=(const DocumentBitmap &other)
+{
+    std::vector<Container> result;
+    auto rhs = other.containers_.begin();
+    for (Container &container : containers_)
+    {
+        while (rhs != other.containers_.end() && rhs->key < container.key)
+        {
+            ++rhs;
+        }
+        if (rhs == other.containers_.end())
+        {
+            break;
+        }
+        if (rhs->key != container.key)
+        {
+            continue;
+        }
+        IntersectContainers(container, *rhs);
+        if (container.cardinality > 0)
+        {
+            result.push_back(std::move(container));
+        }
+    }
+    containers_ = std::move(result);
+    return *this;
+}
+
+DocumentBitmap &DocumentBitmap::operator-=(const DocumentBitmap &other)
+{
+    std::vector<Container> result;
+    result.reserve(containers_.size());
+    auto rhs = other.containers_.begin();
+    for (Container &container : containers_)
+    {
+        while (rhs != other.containers_.end() && rhs->key < container.key)
+        {
+            ++rhs;
+        }
+        if (rhs != other.containers_.end() && rhs->key == container.key)
+        {
+            SubtractContainers(container, *rhs);
+        }
+        if (container.cardinality > 0)
+        {
+            result.push_back(std::move(container));
+        }
+    }
+    containers_ = std::move(result);
+    return *this;
+}
@@ -0,0 +1,121 @@
+//Сжатое множество индексов документов в стиле Roaring:
+//индексы группируются по старшим 16 битам, внутри группы младшие биты хранятся
+//отсортированным массивом (разреженная группа) или битовой картой на 65536 бит (плотная группа).
+//Используется для быстрых операций над множествами документов слов запроса
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+class DocumentBitmap
+{
+public:
+    void Add(int document_id);
+
+    void Remove(int document_id);
+
+    bool Contains(int document_id) const;
+
+    size_t Size() const;
+
+    bool Empty() const
+    {
+        return containers_.empty();
+    }
+
+    // занимаемая динамическая память в байтах
+    size_t MemoryUsage() const;
+
+    // объединение
+    DocumentBitmap &operator|=(const DocumentBitmap &other);
+
+    // пересечение
+    DocumentBitmap &operator&=(const DocumentBitmap &other);
+
+    // разность: убрать документы, присутствующие в other
+    DocumentBitmap &operator-=(const DocumentBitmap &other);
+
+    // вызвать function(document_id) для всех документов в порядке возрастания
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    //группа превращается в битовую карту, когда в ней больше ARRAY_LIMIT элементов
+    static const size_t ARRAY_LIMIT = 4096;
+    static const size_t BITSET_WORDS = 1024;
+
+    struct Container
+    {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits;
+
+        bool IsBitset() const
+        {
+            return !bits.empty();
+        }
+    };
+
+    //группы отсортированы по key, пустые группы не хранятся
+    std::vector<Container> containers_;
+
+    static int LowestBit(uint64_t word);
+
+    std::vector<Container>::iterator FindContainer(uint16_t key);
+    std::vector<Container>::const_iterator FindContainer(uint16_t key) const;
+
+    static bool ContainerContains(const Container &container, uint16_t low);
+    static void ToBitset(Container &container);
+    // выбрать представление по числу элементов после операции над битовой картой
+    static void Normalize(Container &container);
+
+    static void UniteContainers(Container &lhs, const Container &rhs);
+    static void IntersectContainers(Container &lhs, const Container &rhs);
+    static void SubtractContainers(Container &lhs, const Container &rhs);
+};
+
+
+inline int DocumentBitmap::LowestBit(uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while ((word & 1) == 0)
+    {
+        word >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+template <typename Function>
+void DocumentBitmap::ForEach(Function function) const
+{
+    for (const Container &container : containers_)
+    {
+        const int high = static_cast<int>(container.key) << 16;
+        if (!container.IsBitset())
+        {
+            for (const uint16_t low : container.array)
+            {
+                function(high | low);
+            }
+            continue;
+        }
+        for (size_t word_index = 0; word_index < BITSET_WORDS; ++word_index)
+        {
+            uint64_t word = container.bits[word_index];
+            while (word != 0)
+            {
+                function(high | static_cast<int>(word_index * 64 + LowestBit(word)));
+                word &= word - 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#include "perfect_hash.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace
+{
+    // перемешивание splitmix64
+    uint64_t Mix(uint64_t value)
+    {
+        value += 0x9E3779B97F4A7C15ull;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    const uint32_t MAX_DISPLACEMENT_TRIES = 1u << 16;
+    const int MAX_BUILD_ATTEMPTS = 32;
+}
+
+PerfectHashIndex::PerfectHashIndex(const std::vector<std::string_view> &keys)
+{
+    key_offsets_.reserve(keys.size() + 1);
+    key_offsets_.push_back(0);
+    for (const std::string_view key : keys)
+    {
+        key_data_.append(key);
+        key_offsets_.push_back(static_cast<uint32_t>(key_data_.size()));
+    }
+
+    for (int attempt = 0; attempt < MAX_BUILD_ATTEMPTS; ++attempt)
+    {
+        seed_ = Mix(static_cast<uint64_t>(attempt));
+        std::vector<uint64_t> hashes;
+        hashes.reserve(keys.size());
+        for (const std::string_view key : keys)
+        {
+            hashes.push_back(HashKey(key));
+        }
+        if (TryBuild(hashes))
+        {
+            return;
+        }
+    }
+    throw std::invalid_argument("Не удалось построить совершенный хеш (повторяющиеся ключи?)");
+}
+
+uint64_t PerfectHashIndex::HashKey(std::string_view key) const
+{
+    return Mix(std::hash<std::string_view>{}(key) ^ seed_);
+}
+
+size_t PerfectHashIndex::BucketOf(uint64_t hash) const
+{
+    return hash % displacements_.size();
+}
+
+size_t PerfectHashIndex::SlotOf(uint64_t hash, uint32_t displacement) const
+{
+    return Mix(hash + displacement) % slot_to_key_.size();
+}
+
+bool PerfectHashIndex::TryBuild(const std::vector<uint64_t> &hashes)
+{
+    const size_t key_count = hashes.size();
+    //в среднем около четырех ключей на корзину
+    displacements_.assign(std::max<size_t>(1, key_count / 4), 0);
+    slot_to_key_.assign(key_count, 0);
+
+    std::vector<std::vector<uint32_t>> buckets(displacements_.size());
+    for (size_t key = 0; key < key_count; ++key)
+    {
+        buckets[BucketOf(hashes[key])].push_back(static_cast<uint32_t>(key));
+    }
+    //сначала размещаются самые большие корзины, пока таблица почти пуста
+    std::vector<size_t> order(buckets.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&buckets](size_t lhs, size_t rhs) { return buckets[lhs].size() > buckets[rhs].size(); });
+
+    std::vector<bool> occupied(key_count, false);
+    size_t next_free_slot = 0;
+    std::vector<size_t> slots;
+    for (const size_t bucket : order)
+    {
+        const std::vector<uint32_t> &bucket_keys = buckets[bucket];
+        if (bucket_keys.empty())
+        {
+            break;
+        }
+
+        if (bucket_keys.size() == 1)
+        {
+            while (occupied[next_free_slot])
+            {
+                ++next_free_slot;
+            }
+            occupied[next_free_slot] = true;
+            slot_to_key_[next_free_slot] = bucket_keys.front();
+            displacements_[bucket] = DIRECT_SLOT | static_cast<uint32_t>(next_free_slot);
+            continue;
+        }
+
+        bool placed = false;
+        for (uint32_t displacement = 1; displacement < MAX_DISPLACEMENT_TRIES && !placed; ++displacement)
+        {
+            slots.clear();
+            for (const uint32_t key : bucket_keys)
+            {
+                const size_t slot = SlotOf(hashes[key], displacement);
+                if (occupied[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end())
+                {
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (slots.size() != bucket_keys.size())
+            {
+                continue;
+            }
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                occupied[slots[i]] = true;
+                slot_to_key_[slots[i]] = bucket_keys[i];
+            }
+            displacements_[bucket] = displacement;
+            placed = true;
+        }
+        if (!placed)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t PerfectHashIndex::Find(std::string_view key) const
+{
+    if (slot_to_key_.empty())
+    {
+        return npos;
+    }
+    const uint64_t hash = HashKey(key);
+    const uint32_t displacement = displacements_[BucketOf(hash)];
+    if (displacement == 0)
+    {
+        return npos;
+    }
+    const size_t slot = (displacement & DIRECT_SLOT) ? (displacement & ~DIRECT_SLOT) : SlotOf(hash, displacement);
+    const size_t index = slot_to_key_[slot];
+    return GetKey(index) == key ? index : npos;
+}
@@ -0,0 +1,60 @@
+//Минимальная совершенная хеш-функция над фиксированным набором строк (схема hash-and-displace).
+//Каждому ключу соответствует своя позиция 0..n-1, поиск - одно хеширование и одно сравнение строк.
+//Ключи хранятся подряд в одном буфере, набор после построения не меняется
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+class PerfectHashIndex
+{
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    PerfectHashIndex() = default;
+
+    // ключи должны быть уникальны, позиция ключа - его номер в keys
+    explicit PerfectHashIndex(const std::vector<std::string_view> &keys);
+
+    // позиция ключа или npos, если его нет в наборе
+    size_t Find(std::string_view key) const;
+
+    std::string_view GetKey(size_t index) const
+    {
+        return std::string_view(key_data_).substr(key_offsets_[index], key_offsets_[index + 1] - key_offsets_[index]);
+    }
+
+    size_t Size() const
+    {
+        return slot_to_key_.size();
+    }
+
+    // занимаемая динамическая память в байтах
+    size_t MemoryUsage() const
+    {
+        return displacements_.capacity() * sizeof(uint32_t) + slot_to_key_.capacity() * sizeof(uint32_t) +
+               key_data_.capacity() + key_offsets_.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    //старший бит смещения - в корзине один ключ, остальные биты сразу задают его слот
+    static const uint32_t DIRECT_SLOT = 0x80000000u;
+
+    uint64_t seed_ = 0;
+    std::vector<uint32_t> displacements_;
+    std::vector<uint32_t> slot_to_key_;
+    std::string key_data_;
+    std::vector<uint32_t> key_offsets_;
+
+    uint64_t HashKey(std::string_view key) const;
+    size_t BucketOf(uint64_t hash) const;
+    size_t SlotOf(uint64_t hash, uint32_t displacement) const;
+
+    // попытка построения при текущем seed_, false - если подобрать смещения не удалось
+    bool TryBuild(const std::vector<uint64_t> &hashes);
+};
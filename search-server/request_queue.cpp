@@ -5,7 +5,7 @@
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) 
 {
-    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus stat, int rating) { return stat == status; });
+    return AddFindRequest(raw_query, DocumentFilter{status});
 }
 
 
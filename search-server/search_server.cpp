@@ -4,6 +4,7 @@
 #include <cmath>
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
 
 
 
@@ -11,18 +12,37 @@
 void SearchServer::AddDocument(int document_id, const std::string& document, 
                     DocumentStatus status, const std::vector<int>& ratings) 
 {
-    if ((document_id < 0) || (document_info.count(document_id)) || (!IsValidWord(document)))
+    if (frozen_)
+    {
+        throw std::logic_error{"Индекс заморожен, добавление документов невозможно"};
+    }
+
+    std::vector<std::string_view> words;
+    if ((document_id < 0) || (document_info.count(document_id)) || (!SplitIntoWordsNoStop(document, words)))
     {
         throw std::invalid_argument{"Невозможно добавить документ"};
     }
 
-    const std::vector<std::string> words = SplitIntoWordsNoStop(document);
     document_info[document_id].status = status;
+    const size_t status_index = static_cast<size_t>(status);
     const double inv_word_count = 1.0 / words.size();
-    for (const std::string& word : words) 
+    std::map<std::string, double>& document_words = words_frequency_by_documents_[document_id];
+    for (const std::string_view word : words) 
     {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        words_frequency_by_documents_[document_id][word] += inv_word_count;
+        // строка слова создается только при первом его появлении в индексе
+        auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end())
+        {
+            word_it = word_to_document_freqs_.emplace(std::string(word), WordPostings{}).first;
+        }
+        auto [posting_it, inserted] = word_it->second.by_status[status_index].emplace(document_id, 0.0);
+        if (inserted)
+        {
+            ++word_it->second.document_count;
+            word_it->second.documents.Add(document_id);
+        }
+        posting_it->second += inv_word_count;
+        document_words[word_it->first] += inv_word_count;
     }
     document_info[document_id].rating = ComputeAverageRating(ratings);
 
@@ -30,6 +50,49 @@ void SearchServer::AddDocument(int document_id, const std::string& document,
 
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, const DocumentFilter& filter) const
+{
+    return FindTopDocuments(raw_query, QueryMode::ANY_WORD, filter);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, QueryMode mode,
+                                                     const DocumentFilter& filter) const
+{
+    const Query query = ParseQuery(raw_query);
+    std::vector<Document> matched_documents;
+    if (filter.HasRatingRange())
+    {
+        matched_documents = FindAllDocuments(query, mode, filter.status,
+            [this, &filter](int document_id, DocumentStatus)
+            {
+                return filter.AcceptsRating(document_info.at(document_id).rating);
+            });
+    }
+    else
+    {
+        // статус уже обеспечен выбором постингов, дополнительных проверок нет
+        matched_documents = FindAllDocuments(query, mode, filter.status,
+            [](int, DocumentStatus) { return true; });
+    }
+    return SelectTopDocuments(std::move(matched_documents));
+}
+
+std::vector<Document> SearchServer::SelectTopDocuments(std::vector<Document> matched_documents)
+{
+    sort(matched_documents.begin(), matched_documents.end(),
+         [](const Document &lhs, const Document &rhs)
+         {
+             return lhs.relevance > rhs.relevance ||
+                    (abs(lhs.relevance - rhs.relevance) < EPSILON && (lhs.rating > rhs.rating));
+         });
+
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+    {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
+
 int SearchServer::GetDocumentCount() const
 {
     return document_info.size();
@@ -40,19 +103,25 @@ int SearchServer::GetDocumentCount() const
 std::tuple<std::vector<std::string>, DocumentStatus> SearchServer::MatchDocument(const std::string& raw_query, int document_id) const
 {
     const Query query = ParseQuery(raw_query);
+    const DocumentStatus status = document_info.at(document_id).status;
+    const size_t status_index = static_cast<size_t>(status);
     std::vector<std::string> document_words;
 
     for (const std::string& word : query.plus_words) 
     {
-        if (word_to_document_freqs_.count(word) == 0) 
+        const WordPostings* postings = FindPostings(word);
+        if (postings != nullptr && postings->by_status[status_index].count(document_id) > 0)
         {
-            continue;
+            document_words.push_back(word);
         }
-        for (const auto [id, _] : word_to_document_freqs_.at(word)) 
+    }
+    for (const std::string& prefix : query.plus_prefixes)
+    {
+        for (const auto& [word, postings] : ExpandPrefix(prefix))
         {
-            if (id == document_id)
+            if (postings->by_status[status_index].count(document_id) > 0)
             {
-                document_words.push_back(word);
+                document_words.emplace_back(word);
             }
         }
     }
@@ -61,30 +130,102 @@ std::tuple<std::vector<std::string>, DocumentStatus> SearchServer::MatchDocument
     {
         return plus_word1 < plus_word2;
     });
+    // слово могло совпасть и само, и как продолжение префикса
+    document_words.erase(std::unique(document_words.begin(), document_words.end()), document_words.end());
 
     for (const std::string& word : query.minus_words) 
     {
-        if (word_to_document_freqs_.count(word) == 0) 
+        const WordPostings* postings = FindPostings(word);
+        if (postings != nullptr && postings->by_status[status_index].count(document_id) > 0)
         {
-            continue;
+            document_words.clear();
+            break;
         }
-        for (const auto [id, _] : word_to_document_freqs_.at(word)) 
+    }
+    for (const std::string& prefix : query.minus_prefixes)
+    {
+        for (const auto& [_, postings] : ExpandPrefixFully(prefix))
         {
-            if (id == document_id)
+            if (postings->by_status[status_index].count(document_id) > 0)
             {
                 document_words.clear();
+                break;
             }
         }
     }
-    return {document_words, document_info.at(document_id).status};
+    return {document_words, status};
 }
 
 
-bool SearchServer::IsStopWord(const std::string& word) const 
+bool SearchServer::IsStopWord(std::string_view word) const 
 {
+    if (frozen_)
+    {
+        return frozen_->stop_words.Find(word) != PerfectHashIndex::npos;
+    }
     return stop_words_.count(word) > 0;
 }
 
+const SearchServer::WordPostings* SearchServer::FindPostings(std::string_view word) const
+{
+    if (frozen_)
+    {
+        const size_t index = frozen_->terms.Find(word);
+        return index == PerfectHashIndex::npos ? nullptr : &frozen_->postings[index];
+    }
+    const auto word_it = word_to_document_freqs_.find(word);
+    return word_it == word_to_document_freqs_.end() ? nullptr : &word_it->second;
+}
+
+std::vector<std::pair<std::string_view, const SearchServer::WordPostings*>> SearchServer::ExpandPrefix(std::string_view prefix, size_t max_words) const
+{
+    const auto has_prefix = [prefix](std::string_view word)
+    {
+        return word.substr(0, prefix.size()) == prefix;
+    };
+
+    std::vector<std::pair<std::string_view, const WordPostings*>> expansion;
+    if (frozen_)
+    {
+        //слова в замороженном словаре пронумерованы по алфавиту
+        size_t first = 0;
+        size_t last = frozen_->terms.Size();
+        while (first < last)
+        {
+            const size_t middle = first + (last - first) / 2;
+            if (frozen_->terms.GetKey(middle) < prefix)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+        for (size_t index = first; index < frozen_->terms.Size() && expansion.size() < max_words; ++index)
+        {
+            const std::string_view word = frozen_->terms.GetKey(index);
+            if (!has_prefix(word))
+            {
+                break;
+            }
+            expansion.emplace_back(word, &frozen_->postings[index]);
+        }
+        return expansion;
+    }
+
+    for (auto word_it = word_to_document_freqs_.lower_bound(prefix);
+         word_it != word_to_document_freqs_.end() && expansion.size() < max_words; ++word_it)
+    {
+        if (!has_prefix(word_it->first))
+        {
+            break;
+        }
+        expansion.emplace_back(word_it->first, &word_it->second);
+    }
+    return expansion;
+}
+
 bool SearchServer::IsValidWord(const std::string& word) 
 {
     // A valid word must not contain special characters
@@ -95,17 +236,16 @@ bool SearchServer::IsValidWord(const std::string& word)
 }
 
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& text) const 
+bool SearchServer::SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const 
 {
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text)) 
+    if (!SplitIntoValidWords(text, words))
     {
-        if (!IsStopWord(word)) 
-        {
-            words.push_back(word);
-        }
+        return false;
     }
-    return words;
+    words.erase(std::remove_if(words.begin(), words.end(),
+                               [this](std::string_view word) { return IsStopWord(word); }),
+                words.end());
+    return true;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) 
@@ -122,39 +262,56 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings)
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string text) const 
+// Спецсимволы уже отсеяны в ParseQuery при разбиении запроса на слова
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const 
 {
     bool is_minus = false;
-    // Word shouldn't be empty
-    if (text[0] == '-') 
+    if (!text.empty() && text[0] == '-') 
     {
-        if ((text[1] == '-') || (text == "-") || !IsValidWord(text))
+        if ((text.size() == 1) || (text[1] == '-'))
         {
             throw std::invalid_argument("Ошибка в запросе");
         }
 
         is_minus = true;
-        text = text.substr(1);
+        text.remove_prefix(1);
     }
-    if (!IsValidWord(text))
+    // слово вида term* задает префикс, сам префикс не может быть пустым
+    bool is_prefix = false;
+    if (!text.empty() && text.back() == '*')
     {
-        throw std::invalid_argument("Ошибка в запросе");
+        text.remove_suffix(1);
+        if (text.empty())
+        {
+            throw std::invalid_argument("Ошибка в запросе");
+        }
+        is_prefix = true;
     }
     return 
     {
-        text,
+        std::string(text),
         is_minus,
-        IsStopWord(text)
+        !is_prefix && IsStopWord(text),
+        is_prefix
     };
 }
 
 SearchServer::Query SearchServer::ParseQuery(const std::string& text) const 
 {
     Query query;
-    for (const std::string& word : SplitIntoWords(text)) 
+    std::vector<std::string_view> words;
+    if (!SplitIntoValidWords(text, words))
+    {
+        throw std::invalid_argument("Ошибка в запросе");
+    }
+    for (const std::string_view word : words) 
     {
         const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) 
+        if (query_word.is_prefix)
+        {
+            (query_word.is_minus ? query.minus_prefixes : query.plus_prefixes).insert(query_word.data);
+        }
+        else if (!query_word.is_stop) 
         {
             if (query_word.is_minus) 
             {
@@ -169,9 +326,103 @@ SearchServer::Query SearchServer::ParseQuery(const std::string& text) const
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const 
+double SearchServer::ComputeWordInverseDocumentFreq(const WordPostings& postings) const 
 {
-    return log(document_info.size() * 1.0 / word_to_document_freqs_.at(word).size());
+    return log(document_info.size() * 1.0 / postings.document_count);
+}
+
+DocumentBitmap SearchServer::CollectMinusDocuments(const Query& query) const
+{
+    DocumentBitmap excluded;
+    for (const std::string& word : query.minus_words)
+    {
+        const WordPostings* postings = FindPostings(word);
+        if (postings != nullptr)
+        {
+            excluded |= postings->documents;
+        }
+    }
+    for (const std::string& prefix : query.minus_prefixes)
+    {
+        for (const auto& [_, postings] : ExpandPrefixFully(prefix))
+        {
+            excluded |= postings->documents;
+        }
+    }
+    return excluded;
+}
+
+std::vector<std::vector<const SearchServer::WordPostings*>> SearchServer::CollectPlusGroups(const Query& query) const
+{
+    std::vector<std::vector<const WordPostings*>> groups;
+    for (const std::string& word : query.plus_words)
+    {
+        std::vector<const WordPostings*>& group = groups.emplace_back();
+        if (const WordPostings* postings = FindPostings(word))
+        {
+            group.push_back(postings);
+        }
+    }
+    for (const std::string& prefix : query.plus_prefixes)
+    {
+        std::vector<const WordPostings*>& group = groups.emplace_back();
+        for (const auto& [_, postings] : ExpandPrefix(prefix))
+        {
+            group.push_back(postings);
+        }
+    }
+    return groups;
+}
+
+std::vector<SearchServer::QueryTerm> SearchServer::CollectQueryTerms(const std::vector<std::vector<const WordPostings*>>& groups) const
+{
+    std::vector<const WordPostings*> postings;
+    for (const auto& group : groups)
+    {
+        postings.insert(postings.end(), group.begin(), group.end());
+    }
+    // слово могло попасть в запрос и само, и как продолжение префикса - учитываем его один раз
+    std::sort(postings.begin(), postings.end());
+    postings.erase(std::unique(postings.begin(), postings.end()), postings.end());
+
+    std::vector<QueryTerm> terms;
+    terms.reserve(postings.size());
+    for (const WordPostings* word_postings : postings)
+    {
+        terms.push_back({word_postings, ComputeWordInverseDocumentFreq(*word_postings)});
+    }
+    return terms;
+}
+
+DocumentBitmap SearchServer::IntersectGroups(const std::vector<std::vector<const WordPostings*>>& groups)
+{
+    std::vector<DocumentBitmap> group_documents;
+    for (const auto& group : groups)
+    {
+        DocumentBitmap& documents = group_documents.emplace_back();
+        for (const WordPostings* postings : group)
+        {
+            documents |= postings->documents;
+        }
+        if (documents.Empty())
+        {
+            return {};
+        }
+    }
+    if (group_documents.empty())
+    {
+        return {};
+    }
+
+    // пересечение выгоднее начинать с самых редких слов
+    std::sort(group_documents.begin(), group_documents.end(),
+              [](const DocumentBitmap& lhs, const DocumentBitmap& rhs) { return lhs.Size() < rhs.Size(); });
+    DocumentBitmap candidates = std::move(group_documents.front());
+    for (size_t i = 1; i < group_documents.size() && !candidates.Empty(); ++i)
+    {
+        candidates &= group_documents[i];
+    }
+    return candidates;
 }
 
 std::set<int>::const_iterator SearchServer::begin() 
@@ -194,6 +445,11 @@ const std::map<std::string, double>& SearchServer::GetWordFrequencies(int docume
 {
     static std::map<std::string, double> words_in_document;
 
+    if (frozen_ && frozen_->forward_index_mode != ForwardIndexMode::FULL)
+    {
+        throw std::logic_error{"Словари слов документов не хранятся в замороженном индексе"};
+    }
+
     if (words_frequency_by_documents_.count(document_id) > 0)
         return words_frequency_by_documents_.at(document_id);
 
@@ -202,14 +458,228 @@ const std::map<std::string, double>& SearchServer::GetWordFrequencies(int docume
 
 void SearchServer::RemoveDocument(int document_id)
 {
+    if (frozen_)
+    {
+        throw std::logic_error{"Индекс заморожен, удаление документов невозможно"};
+    }
+
+    const size_t status_index = static_cast<size_t>(document_info.at(document_id).status);
     document_info.erase(document_id);
     document_indexes.erase(document_id);
     for (const auto& [word, _] : words_frequency_by_documents_.at(document_id))
     {
-        word_to_document_freqs_.at(word).erase(document_id);
-        if (word_to_document_freqs_.at(word).empty()) word_to_document_freqs_.erase(word);
+        const auto word_it = word_to_document_freqs_.find(word);
+        word_it->second.by_status[status_index].erase(document_id);
+        word_it->second.documents.Remove(document_id);
+        if (--word_it->second.document_count == 0) word_to_document_freqs_.erase(word_it);
     }
 
     words_frequency_by_documents_.erase(document_id);
 }
 
+std::vector<std::pair<std::string_view, double>> SearchServer::GetDocumentWords(int document_id) const
+{
+    std::vector<std::pair<std::string_view, double>> document_words;
+    if (!frozen_ || frozen_->forward_index_mode == ForwardIndexMode::FULL)
+    {
+        const auto document_it = words_frequency_by_documents_.find(document_id);
+        if (document_it != words_frequency_by_documents_.end())
+        {
+            document_words.assign(document_it->second.begin(), document_it->second.end());
+        }
+        return document_words;
+    }
+
+    if (frozen_->forward_index_mode == ForwardIndexMode::NONE)
+    {
+        throw std::logic_error{"Прямой индекс не хранится"};
+    }
+    const CompactForwardIndex& compact = frozen_->compact_forward_index;
+    const std::vector<int>& document_ids = compact.document_ids;
+    const auto id_it = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    if (id_it == document_ids.end() || *id_it != document_id)
+    {
+        return document_words;
+    }
+    const size_t position = id_it - document_ids.begin();
+    const uint32_t begin = compact.word_offsets[position];
+    const uint32_t end = position + 1 < document_ids.size()
+                             ? compact.word_offsets[position + 1]
+                             : static_cast<uint32_t>(compact.term_ids.size());
+    document_words.reserve(end - begin);
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        document_words.emplace_back(frozen_->terms.GetKey(compact.term_ids[i]),
+                                    compact.term_freqs[i]);
+    }
+    return document_words;
+}
+
+SearchServer::CompactForwardIndex SearchServer::BuildCompactForwardIndex(const PerfectHashIndex& terms) const
+{
+    CompactForwardIndex compact;
+    compact.document_ids.reserve(words_frequency_by_documents_.size());
+    compact.word_offsets.reserve(words_frequency_by_documents_.size());
+    //документы перебираются по возрастанию индексов
+    for (const auto& [document_id, word_freqs] : words_frequency_by_documents_)
+    {
+        compact.document_ids.push_back(document_id);
+        compact.word_offsets.push_back(static_cast<uint32_t>(compact.term_ids.size()));
+        //слова в terms пронумерованы по алфавиту, поэтому номера идут по возрастанию
+        for (const auto& [word, term_freq] : word_freqs)
+        {
+            compact.term_ids.push_back(static_cast<uint32_t>(terms.Find(word)));
+            compact.term_freqs.push_back(term_freq);
+        }
+    }
+    compact.term_ids.shrink_to_fit();
+    compact.term_freqs.shrink_to_fit();
+    return compact;
+}
+
+void SearchServer::ChangeForwardIndexMode(ForwardIndexMode forward_index)
+{
+    const ForwardIndexMode current = frozen_->forward_index_mode;
+    if (forward_index == current)
+    {
+        return;
+    }
+    //режимы упорядочены от полного к пустому, удаленные данные не восстановить
+    if (static_cast<int>(forward_index) < static_cast<int>(current))
+    {
+        throw std::logic_error{"Прямой индекс уже сокращен, вернуть более полное хранение невозможно"};
+    }
+
+    if (forward_index == ForwardIndexMode::COMPACT)
+    {
+        frozen_->compact_forward_index = BuildCompactForwardIndex(frozen_->terms);
+    }
+    else
+    {
+        frozen_->compact_forward_index = CompactForwardIndex{};
+    }
+    words_frequency_by_documents_.clear();
+    frozen_->forward_index_mode = forward_index;
+}
+
+void SearchServer::Freeze(ForwardIndexMode forward_index)
+{
+    if (frozen_)
+    {
+        ChangeForwardIndexMode(forward_index);
+        return;
+    }
+
+    //все, что может бросить исключение, строится до переноса постингов,
+    //чтобы при ошибке сервер остался незамороженным и неизменным
+    FrozenIndex frozen;
+    std::vector<std::string_view> terms;
+    terms.reserve(word_to_document_freqs_.size());
+    for (const auto& [word, _] : word_to_document_freqs_)
+    {
+        terms.push_back(word);
+    }
+    frozen.terms = PerfectHashIndex(terms);
+
+    const std::vector<std::string_view> stop_words(stop_words_.begin(), stop_words_.end());
+    frozen.stop_words = PerfectHashIndex(stop_words);
+
+    frozen.forward_index_mode = forward_index;
+    if (forward_index == ForwardIndexMode::COMPACT)
+    {
+        frozen.compact_forward_index = BuildCompactForwardIndex(frozen.terms);
+    }
+    frozen.postings.reserve(word_to_document_freqs_.size());
+    for (auto& [_, postings] : word_to_document_freqs_)
+    {
+        frozen.postings.push_back(std::move(postings));
+    }
+
+    if (forward_index != ForwardIndexMode::FULL)
+    {
+        words_frequency_by_documents_.clear();
+    }
+
+    frozen_ = std::move(frozen);
+    word_to_document_freqs_.clear();
+    stop_words_.clear();
+}
+
+namespace
+{
+    //служебная часть узла красно-черного дерева: цвет и три указателя
+    const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+
+    template <typename Tree>
+    size_t TreeNodesMemory(const Tree& tree)
+    {
+        return tree.size() * (TREE_NODE_OVERHEAD + sizeof(typename Tree::value_type));
+    }
+
+    //память строки вне объекта; короткие строки хранятся внутри него
+    size_t StringHeapMemory(const std::string& str)
+    {
+        const char* object = reinterpret_cast<const char*>(&str);
+        const bool is_inline = str.data() >= object && str.data() < object + sizeof(str);
+        return is_inline ? 0 : str.capacity() + 1;
+    }
+}
+
+size_t SearchServer::PostingsMemory(const WordPostings& postings)
+{
+    size_t bytes = postings.documents.MemoryUsage();
+    for (const auto& status_postings : postings.by_status)
+    {
+        bytes += TreeNodesMemory(status_postings);
+    }
+    return bytes;
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const
+{
+    MemoryUsage usage;
+
+    if (frozen_)
+    {
+        usage.term_dictionary = frozen_->terms.MemoryUsage();
+        usage.postings = frozen_->postings.capacity() * sizeof(WordPostings);
+        for (const WordPostings& postings : frozen_->postings)
+        {
+            usage.postings += PostingsMemory(postings);
+        }
+        usage.stop_words = frozen_->stop_words.MemoryUsage();
+        const CompactForwardIndex& compact = frozen_->compact_forward_index;
+        usage.forward_index = compact.document_ids.capacity() * sizeof(int) +
+                              compact.word_offsets.capacity() * sizeof(uint32_t) +
+                              compact.term_ids.capacity() * sizeof(uint32_t) +
+                              compact.term_freqs.capacity() * sizeof(double);
+    }
+
+    //узел словаря делится между словарем (ключ) и постингами (значение)
+    usage.term_dictionary += word_to_document_freqs_.size() * (TREE_NODE_OVERHEAD + sizeof(std::string));
+    usage.postings += word_to_document_freqs_.size() * sizeof(WordPostings);
+    for (const auto& [word, postings] : word_to_document_freqs_)
+    {
+        usage.term_dictionary += StringHeapMemory(word);
+        usage.postings += PostingsMemory(postings);
+    }
+
+    usage.forward_index += TreeNodesMemory(words_frequency_by_documents_);
+    for (const auto& [_, word_freqs] : words_frequency_by_documents_)
+    {
+        usage.forward_index += TreeNodesMemory(word_freqs);
+        for (const auto& word_freq : word_freqs)
+        {
+            usage.forward_index += StringHeapMemory(word_freq.first);
+        }
+    }
+
+    usage.document_metadata = TreeNodesMemory(document_info) + TreeNodesMemory(document_indexes);
+
+    usage.stop_words += TreeNodesMemory(stop_words_);
+    for (const std::string& word : stop_words_)
+    {
+        usage.stop_words += StringHeapMemory(word);
+    }
+    return usage;
+}
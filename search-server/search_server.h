@@ -4,19 +4,60 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <iterator>
+#include <limits>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include <math.h>
 
 #include "document.h"
+#include "document_bitmap.h"
+#include "perfect_hash.h"
 #include "string_processing.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
+//сколько слов индекса может подставить один плюс-префикс term* (берутся первые по алфавиту);
+//минус-префикс -term* исключает документы со всеми продолжениями
+const size_t MAX_PREFIX_EXPANSION = 64;
+
+// режим поиска: документ должен содержать хотя бы одно плюс-слово или все плюс-слова запроса
+enum class QueryMode
+{
+    ANY_WORD,
+    ALL_WORDS,
+};
+
+// хранение прямого индекса (слова каждого документа и их TF) в замороженном сервере:
+// FULL - словари слов как до заморозки, COMPACT - отсортированные массивы номеров слов,
+// NONE - прямой индекс не хранится (порядок значений - от полного хранения к пустому)
+enum class ForwardIndexMode
+{
+    FULL,
+    COMPACT,
+    NONE,
+};
+
+// оценка занимаемой сервером памяти в байтах по структурам данных
+struct MemoryUsage
+{
+    size_t term_dictionary = 0;
+    size_t postings = 0;
+    size_t forward_index = 0;
+    size_t document_metadata = 0;
+    size_t stop_words = 0;
+
+    size_t Total() const
+    {
+        return term_dictionary + postings + forward_index + document_metadata + stop_words;
+    }
+};
 
 
 class SearchServer
@@ -42,10 +83,16 @@ public:
     template <typename Predicate>
     std::vector<Document> FindTopDocuments(const std::string &raw_query, Predicate predicate) const;
 
+    // фильтр по статусу и рейтингу просматривает только постинги документов с нужным статусом
+    std::vector<Document> FindTopDocuments(const std::string &raw_query, const DocumentFilter &filter) const;
+
+    // в режиме ALL_WORDS кандидаты находятся пересечением множеств документов плюс-слов до подсчета релевантности
+    std::vector<Document> FindTopDocuments(const std::string &raw_query, QueryMode mode,
+                                           const DocumentFilter &filter = {}) const;
+
     std::vector<Document> FindTopDocuments(const std::string &raw_query, DocumentStatus status) const
     {
-        return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus stat, int rating)
-                                { return stat == status; });
+        return FindTopDocuments(raw_query, DocumentFilter{status});
     }
 
     std::vector<Document> FindTopDocuments(const std::string &raw_query) const
@@ -62,9 +109,28 @@ public:
 
     std::set<int>::const_iterator end();
 
+    // недоступно в замороженном сервере с прямым индексом COMPACT или NONE
     const std::map<std::string, double>& GetWordFrequencies(int document_id) const;
 
+    // слова документа по возрастанию и их TF; строки принадлежат серверу
+    std::vector<std::pair<std::string_view, double>> GetDocumentWords(int document_id) const;
+
     void RemoveDocument(int document_id);
+
+    // заморозить индекс: словарь слов и стоп-слова переносятся в компактные таблицы
+    // с совершенным хешированием; после этого добавлять и удалять документы нельзя.
+    // Повторный вызов у замороженного сервера меняет хранение прямого индекса:
+    // FULL -> COMPACT/NONE и COMPACT -> NONE разрешены, возврат к более полному
+    // хранению невозможен (данные уже удалены) и приводит к std::logic_error
+    void Freeze(ForwardIndexMode forward_index = ForwardIndexMode::FULL);
+
+    bool IsFrozen() const
+    {
+        return frozen_.has_value();
+    }
+
+    // приблизительная оценка: учитываются содержимое и служебные узлы контейнеров
+    MemoryUsage GetMemoryUsage() const;
     ///////////////////////////////
     std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string &raw_query, int document_id) const;
 
@@ -75,11 +141,48 @@ private:
         int rating;
     };
 
-    std::set<std::string> stop_words_;
+    std::set<std::string, std::less<>> stop_words_;
+
+    //постинги слова: индексы документов, где оно встречается, и TF,
+    //разложенные по статусам документов.
+    //Цена разбиения: пустая структура занимает около 224 байт (четыре заголовка map и битовая карта)
+    //против 48 байт одного map, поэтому для словаря из множества редких слов память растет
+    //сильнее, чем экономится на пропуске постингов BANNED/REMOVED; см. GetMemoryUsage().postings
+    struct WordPostings
+    {
+        std::array<std::map<int, double>, DOCUMENT_STATUS_COUNT> by_status;
+        size_t document_count = 0;
+        //те же документы всех статусов - для операций над множествами
+        DocumentBitmap documents;
+    };
+
+    //обработанные слова документов - слово из документа и его постинги
+    std::map<std::string, WordPostings, std::less<>> word_to_document_freqs_;
+
+    //прямой индекс COMPACT: номера слов (по возрастанию) и TF всех документов подряд;
+    //для документа document_ids[i] его слова начинаются с word_offsets[i]
+    //и заканчиваются началом следующего документа
+    struct CompactForwardIndex
+    {
+        std::vector<int> document_ids;
+        std::vector<uint32_t> word_offsets;
+        std::vector<uint32_t> term_ids;
+        std::vector<double> term_freqs;
+    };
 
-    //обработанные слова документов - слово из документа и соответствующий ему словарь 
-    //индексов документов, где встречается, и TF
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
+    //снимок индекса только для чтения: после Freeze() словарь и стоп-слова живут только здесь
+    struct FrozenIndex
+    {
+        PerfectHashIndex terms;
+        //постинги в порядке позиций слов в terms
+        std::vector<WordPostings> postings;
+        PerfectHashIndex stop_words;
+
+        ForwardIndexMode forward_index_mode = ForwardIndexMode::FULL;
+        CompactForwardIndex compact_forward_index;
+    };
+
+    std::optional<FrozenIndex> frozen_;
 
     std::map<int, StatusAndRating> document_info;
 
@@ -95,36 +198,93 @@ private:
         std::string data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
     };
 
     struct Query
     {
         std::set<std::string> plus_words;
         std::set<std::string> minus_words;
+        //префиксы из слов запроса вида term*
+        std::set<std::string> plus_prefixes;
+        std::set<std::string> minus_prefixes;
+    };
+
+    //постинги слова запроса и его IDF
+    struct QueryTerm
+    {
+        const WordPostings *postings;
+        double inverse_document_freq;
     };
 
-    bool IsStopWord(const std::string &word) const;
+    bool IsStopWord(std::string_view word) const;
+
+    // постинги слова или nullptr, если слова нет в индексе
+    const WordPostings *FindPostings(std::string_view word) const;
+
+    // слова индекса, начинающиеся с prefix, по алфавиту (не больше max_words), и их постинги
+    std::vector<std::pair<std::string_view, const WordPostings *>> ExpandPrefix(
+        std::string_view prefix, size_t max_words = MAX_PREFIX_EXPANSION) const;
+
+    // все слова индекса, начинающиеся с prefix - для минус-префиксов, где ограничение менять смысл не должно
+    std::vector<std::pair<std::string_view, const WordPostings *>> ExpandPrefixFully(std::string_view prefix) const
+    {
+        return ExpandPrefix(prefix, std::numeric_limits<size_t>::max());
+    }
+
+    // прямой индекс COMPACT из words_frequency_by_documents_ с номерами слов из terms
+    CompactForwardIndex BuildCompactForwardIndex(const PerfectHashIndex &terms) const;
+
+    // сменить хранение прямого индекса замороженного сервера
+    void ChangeForwardIndexMode(ForwardIndexMode forward_index);
+
+    // динамическая память постингов одного слова
+    static size_t PostingsMemory(const WordPostings &postings);
 
     static bool IsValidWord(const std::string &word);
 
-    // Разделить на слова без стоп-слов
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string &text) const;
+    // Разделить на слова без стоп-слов, false - если в тексте есть спецсимволы
+    bool SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view> &words) const;
 
     // Вычислить средний рейтинг
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
     // Разобрать слово запроса
-    QueryWord ParseQueryWord(std::string text) const;
+    QueryWord ParseQueryWord(std::string_view text) const;
 
     // разобрать запрос
     Query ParseQuery(const std::string &text) const;
 
     // Вычислить Word Inverse DocumentFreq
-    double ComputeWordInverseDocumentFreq(const std::string &word) const;
+    double ComputeWordInverseDocumentFreq(const WordPostings &postings) const;
 
-    // найти все документы
-    template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const Query &query, Predicate predicate) const;
+    // документы, содержащие хотя бы одно минус-слово запроса или продолжение минус-префикса
+    DocumentBitmap CollectMinusDocuments(const Query &query) const;
+
+    // постинги плюс-слов запроса по группам: для слова - оно само (или ничего, если его нет в индексе),
+    // для префикса - все его продолжения
+    std::vector<std::vector<const WordPostings *>> CollectPlusGroups(const Query &query) const;
+
+    // различные постинги всех групп с их IDF
+    std::vector<QueryTerm> CollectQueryTerms(const std::vector<std::vector<const WordPostings *>> &groups) const;
+
+    // документы, в которых есть слово из каждой группы
+    static DocumentBitmap IntersectGroups(const std::vector<std::vector<const WordPostings *>> &groups);
+
+    // слияние постингов статуса status_index за один проход по возрастанию индексов документов:
+    // для документа, где skip(document_id) вернул true, курсоры только сдвигаются без подсчета релевантности,
+    // для остальных consumer(document_id, relevance) вызывается один раз
+    template <typename Skip, typename Consumer>
+    static void MergePostings(const std::vector<QueryTerm> &terms, size_t status_index, Skip skip, Consumer consumer);
+
+    // найти все документы: просматриваются постинги только статуса status (или всех, если не задан),
+    // документ учитывается, если check(document_id, status) вернул true
+    template <typename DocumentCheck>
+    std::vector<Document> FindAllDocuments(const Query &query, QueryMode mode, std::optional<DocumentStatus> status,
+                                           DocumentCheck check) const;
+
+    // отсортировать по релевантности и оставить MAX_RESULT_DOCUMENT_COUNT лучших
+    static std::vector<Document> SelectTopDocuments(std::vector<Document> matched_documents);
 };
 
 
@@ -133,7 +293,7 @@ void RemoveDuplicates(SearchServer& search_server);
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer &stop_words)
 {
-    std::set<std::string> non_empty_strings;
+    std::set<std::string, std::less<>> non_empty_strings;
     for (const std::string &str : stop_words)
     {
         if (!IsValidWord(str))
@@ -151,62 +311,124 @@ template <typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string &raw_query, Predicate predicate) const
 {
     const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, predicate);
-
-    sort(matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs)
-         {
-             return lhs.relevance > rhs.relevance ||
-                    (abs(lhs.relevance - rhs.relevance) < EPSILON && (lhs.rating > rhs.rating));
-         });
+    auto matched_documents = FindAllDocuments(query, QueryMode::ANY_WORD, std::nullopt,
+        [this, &predicate](int document_id, DocumentStatus status)
+        {
+            return predicate(document_id, status, document_info.at(document_id).rating);
+        });
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-    {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    return SelectTopDocuments(std::move(matched_documents));
 }
 
-template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query &query, Predicate predicate) const
+template <typename Skip, typename Consumer>
+void SearchServer::MergePostings(const std::vector<QueryTerm> &terms, size_t status_index, Skip skip, Consumer consumer)
 {
-    std::map<int, double> document_to_relevance;
-    for (const std::string &word : query.plus_words)
+    struct Cursor
     {
-        if (word_to_document_freqs_.count(word) == 0)
-        {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+        std::map<int, double>::const_iterator current;
+        std::map<int, double>::const_iterator end;
+        double inverse_document_freq;
+    };
+    //куча с наименьшим текущим индексом документа на вершине
+    const auto later = [](const Cursor &lhs, const Cursor &rhs)
+    {
+        return lhs.current->first > rhs.current->first;
+    };
+
+    std::vector<Cursor> heap;
+    heap.reserve(terms.size());
+    for (const QueryTerm &term : terms)
+    {
+        const std::map<int, double> &postings = term.postings->by_status[status_index];
+        if (!postings.empty())
         {
-            if (!predicate(document_id, document_info.at(document_id).status, document_info.at(document_id).rating))
-            {
-                continue;
-            }
-            document_to_relevance[document_id] += term_freq * inverse_document_freq;
+            heap.push_back({postings.begin(), postings.end(), term.inverse_document_freq});
         }
     }
+    std::make_heap(heap.begin(), heap.end(), later);
 
-    for (const std::string &word : query.minus_words)
+    while (!heap.empty())
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        const int document_id = heap.front().current->first;
+        const bool skipped = skip(document_id);
+        double relevance = 0.0;
+        while (!heap.empty() && heap.front().current->first == document_id)
         {
-            continue;
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Cursor &cursor = heap.back();
+            if (!skipped)
+            {
+                relevance += cursor.current->second * cursor.inverse_document_freq;
+            }
+            if (++cursor.current == cursor.end)
+            {
+                heap.pop_back();
+            }
+            else
+            {
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+        if (!skipped)
         {
-            document_to_relevance.erase(document_id);
+            consumer(document_id, relevance);
         }
     }
+}
 
+template <typename DocumentCheck>
+std::vector<Document> SearchServer::FindAllDocuments(const Query &query, QueryMode mode, std::optional<DocumentStatus> status,
+                                                     DocumentCheck check) const
+{
+    // документы с минус-словами отбрасываются до подсчета релевантности
+    const DocumentBitmap excluded = CollectMinusDocuments(query);
+    const std::vector<std::vector<const WordPostings *>> groups = CollectPlusGroups(query);
+    const std::vector<QueryTerm> terms = CollectQueryTerms(groups);
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance)
+
+    if (mode == QueryMode::ALL_WORDS)
+    {
+        DocumentBitmap candidates = IntersectGroups(groups);
+        candidates -= excluded;
+        candidates.ForEach([&](int document_id)
+        {
+            const StatusAndRating &info = document_info.at(document_id);
+            if ((status && *status != info.status) || !check(document_id, info.status))
+            {
+                return;
+            }
+            const size_t status_index = static_cast<size_t>(info.status);
+            double relevance = 0.0;
+            for (const QueryTerm &term : terms)
+            {
+                const std::map<int, double> &postings = term.postings->by_status[status_index];
+                const auto posting_it = postings.find(document_id);
+                if (posting_it != postings.end())
+                {
+                    relevance += posting_it->second * term.inverse_document_freq;
+                }
+            }
+            matched_documents.push_back({document_id, relevance, info.rating});
+        });
+        return matched_documents;
+    }
+
+    for (size_t status_index = 0; status_index < DOCUMENT_STATUS_COUNT; ++status_index)
     {
-        matched_documents.push_back(
-            {document_id,
-             relevance,
-             document_info.at(document_id).rating});
+        const DocumentStatus posting_status = static_cast<DocumentStatus>(status_index);
+        if (status && *status != posting_status)
+        {
+            continue;
+        }
+        MergePostings(terms, status_index,
+            [&](int document_id)
+            {
+                return excluded.Contains(document_id) || !check(document_id, posting_status);
+            },
+            [&](int document_id, double relevance)
+            {
+                matched_documents.push_back({document_id, relevance, document_info.at(document_id).rating});
+            });
     }
     return matched_documents;
 }
\ No newline at end of file
@@ -1,5 +1,11 @@
 #include "string_processing.h"
 #include <algorithm>
+#include <cstdint>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define SEARCH_SERVER_SIMD_SCAN 1
+#include <immintrin.h>
+#endif
 
 
 std::vector<std::string> SplitIntoWords(const std::string &text) 
@@ -16,4 +22,116 @@ std::vector<std::string> SplitIntoWords(const std::string &text)
 
     words.emplace_back(word);
     return words;
-}
\ No newline at end of file
+}
+
+namespace
+{
+    using WordList = std::vector<std::string_view>;
+    using ScanFunction = bool (*)(std::string_view text, WordList &words);
+
+    // Побайтный разбор текста начиная с позиции pos, текущее слово начинается с word_begin
+    bool ScanScalar(std::string_view text, size_t pos, size_t word_begin, WordList &words)
+    {
+        for (; pos < text.size(); ++pos)
+        {
+            const char symbol = text[pos];
+            if (symbol == ' ')
+            {
+                words.push_back(text.substr(word_begin, pos - word_begin));
+                word_begin = pos + 1;
+            }
+            else if (symbol >= '\0' && symbol < ' ')
+            {
+                return false;
+            }
+        }
+        words.push_back(text.substr(word_begin));
+        return true;
+    }
+
+#ifndef SEARCH_SERVER_SIMD_SCAN
+    bool ScanScalarAll(std::string_view text, WordList &words)
+    {
+        return ScanScalar(text, 0, 0, words);
+    }
+#else
+    // Добавляет слова, заканчивающиеся на пробелах, отмеченных битами space_mask
+    // (бит i соответствует байту base + i)
+    inline void PushWordsByMask(std::string_view text, size_t base, uint32_t space_mask,
+                                size_t &word_begin, WordList &words)
+    {
+        while (space_mask != 0)
+        {
+            const size_t pos = base + __builtin_ctz(space_mask);
+            words.push_back(text.substr(word_begin, pos - word_begin));
+            word_begin = pos + 1;
+            space_mask &= space_mask - 1;
+        }
+    }
+
+    bool ScanSse2(std::string_view text, WordList &words)
+    {
+        const __m128i spaces = _mm_set1_epi8(' ');
+        const __m128i minus_one = _mm_set1_epi8(-1);
+        size_t pos = 0;
+        size_t word_begin = 0;
+        for (; pos + 16 <= text.size(); pos += 16)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text.data() + pos));
+            // спецсимвол: 0 <= c < ' ' (char знаковый, как и в побайтной проверке)
+            const __m128i control = _mm_and_si128(_mm_cmpgt_epi8(chunk, minus_one),
+                                                  _mm_cmplt_epi8(chunk, spaces));
+            if (_mm_movemask_epi8(control) != 0)
+            {
+                return false;
+            }
+            const uint32_t space_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces)));
+            PushWordsByMask(text, pos, space_mask, word_begin, words);
+        }
+        return ScanScalar(text, pos, word_begin, words);
+    }
+
+    __attribute__((target("avx2")))
+    bool ScanAvx2(std::string_view text, WordList &words)
+    {
+        const __m256i spaces = _mm256_set1_epi8(' ');
+        const __m256i minus_one = _mm256_set1_epi8(-1);
+        size_t pos = 0;
+        size_t word_begin = 0;
+        for (; pos + 32 <= text.size(); pos += 32)
+        {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text.data() + pos));
+            const __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, minus_one),
+                                                     _mm256_cmpgt_epi8(spaces, chunk));
+            if (_mm256_movemask_epi8(control) != 0)
+            {
+                return false;
+            }
+            const uint32_t space_mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, spaces)));
+            PushWordsByMask(text, pos, space_mask, word_begin, words);
+        }
+        return ScanScalar(text, pos, word_begin, words);
+    }
+#endif
+
+    ScanFunction SelectScanFunction()
+    {
+#ifdef SEARCH_SERVER_SIMD_SCAN
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return ScanAvx2;
+        }
+        return ScanSse2;
+#else
+        return ScanScalarAll;
+#endif
+    }
+}
+
+bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view> &words)
+{
+    static const ScanFunction scan = SelectScanFunction();
+    words.clear();
+    return scan(text, words);
+}
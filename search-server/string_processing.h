@@ -4,7 +4,15 @@
 
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
-std::vector<std::string> SplitIntoWords(const std::string &text);
\ No newline at end of file
+std::vector<std::string> SplitIntoWords(const std::string &text);
+
+// Разбивает текст на слова по пробелам и за тот же проход проверяет,
+// что в нем нет спецсимволов (коды 0-31). Слова ссылаются на память text.
+// Возвращает false, если спецсимвол найден - содержимое words тогда не определено.
+// Сканирование идет блоками SSE2/AVX2, вариант выбирается при первом вызове
+// по возможностям процессора; на других платформах - побайтно.
+bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view> &words);